@@ -1,5 +1,7 @@
 #include "llvm/Pass.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/DataLayout.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/IR/Dominators.h"
 #include "llvm/Analysis/LoopInfo.h"
@@ -15,6 +17,7 @@
 #include <fstream>
 #include <string>
 #include <map>
+#include <set>
 #include <regex>
 
 using namespace llvm;
@@ -29,96 +32,111 @@ namespace {
     A3() : FunctionPass(ID), ilp_file(OutputFilename) {
     }
 
-    // getInductionVariable function is from LLVM source code
-    // lib/Transforms/Scalar/LoopInterchange.cpp
-    PHINode *getInductionVariable(const Loop *L, ScalarEvolution *SE) {
-      PHINode *InnerIndexVar = L->getCanonicalInductionVariable();
-      if (InnerIndexVar)
-        return InnerIndexVar;
+    // getInductionVariables is adapted from getInductionVariable in LLVM
+    // lib/Transforms/Scalar/LoopInterchange.cpp, but collects every affine
+    // header PHI with a constant step instead of stopping at the first one.
+    // The canonical induction variable (if any) is always first.
+    void getInductionVariables(const Loop *L, ScalarEvolution *SE, SmallVectorImpl<PHINode *> &IVs) {
+      PHINode *CanonicalVar = L->getCanonicalInductionVariable();
+      if (CanonicalVar)
+        IVs.push_back(CanonicalVar);
       if (L->getLoopLatch() == nullptr || L->getLoopPredecessor() == nullptr)
-        return nullptr;
+        return;
       for (BasicBlock::iterator I = L->getHeader()->begin(); isa<PHINode>(I); ++I) {
         PHINode *PhiVar = cast<PHINode>(I);
+        if (PhiVar == CanonicalVar)
+          continue;
         Type *PhiTy = PhiVar->getType();
-        if (!PhiTy->isIntegerTy() && !PhiTy->isFloatingPointTy() &&
-            !PhiTy->isPointerTy())
-          return nullptr;
+        if (!PhiTy->isIntegerTy() && !PhiTy->isPointerTy())
+          continue;
         const SCEVAddRecExpr *AddRec =
             dyn_cast<SCEVAddRecExpr>(SE->getSCEV(PhiVar));
-        if (!AddRec || !AddRec->isAffine())
+        if (!AddRec || !AddRec->isAffine() || AddRec->getLoop() != L)
           continue;
         const SCEV *Step = AddRec->getStepRecurrence(*SE);
-        if (!isa<SCEVConstant>(Step))
+        if (!isa<SCEVConstant>(Step) || Step->isZero())
           continue;
-        // Found the induction variable.
-        // FIXME: Handle loops with more than one induction variable. Note that,
-        // currently, legality makes sure we have only one induction variable.
-        return PhiVar;
+        IVs.push_back(PhiVar);
       }
-      return nullptr;
+    }
+
+    /// true if L tests its exit condition in the header rather than the latch.
+    /// OPTARGS does not rotate loops, so this is the usual shape of a for loop;
+    /// the header then runs once more than the body, and the IV's value at the
+    /// backedge-taken count is the one that fails the test
+    static bool exitsFromHeader(const Loop *L) {
+      BasicBlock *Latch = L->getLoopLatch();
+      return L->isLoopExiting(L->getHeader()) && (!Latch || !L->isLoopExiting(Latch));
     }
 
     /// get the range of an induction variable (inclusive lower and upper bound)
+    /// for a negative step, the start is the upper bound and the last value
+    /// the body sees is the lower bound
     void IVgetRange(const SCEVAddRecExpr *IV, ScalarEvolution *SE, std::string &lower, std::string &upper) {
-      const SCEVNAryExpr *AE = dyn_cast<SCEVNAryExpr>(IV);
       raw_string_ostream lsso(lower), usso(upper);
-
-      if (isa<SCEVConstant>(AE->getOperand(0))){
-        const SCEVConstant *CE = dyn_cast<SCEVConstant>(AE->getOperand(0));
-        lsso << CE->getValue()->getSExtValue();
+      const SCEVConstant *Step = dyn_cast<SCEVConstant>(IV->getStepRecurrence(*SE));
+      bool negative = Step && Step->getAPInt().isNegative();
+      std::string &first = negative ? upper : lower;
+      std::string &last = negative ? lower : upper;
+      raw_string_ostream &fsso = negative ? usso : lsso;
+      raw_string_ostream &lastsso = negative ? lsso : usso;
+
+      if (isa<SCEVConstant>(IV->getStart())){
+        const SCEVConstant *CE = dyn_cast<SCEVConstant>(IV->getStart());
+        fsso << CE->getValue()->getSExtValue();
       } else{
-        lower.clear(); // lower bound is Unknown
+        first.clear(); // bound is Unknown
       }
 
       const SCEV *EP = SE->getSCEVAtScope(IV, IV->getLoop()->getParentLoop());
-      if (isa<SCEVConstant>(EP)){
+      if (isa<SCEVConstant>(EP) && Step){
         const SCEVConstant *EPP = dyn_cast<SCEVConstant>(EP);
-        usso << EPP->getValue()->getSExtValue() - 1;
+        int64_t exit_value = EPP->getValue()->getSExtValue();
+        if (exitsFromHeader(IV->getLoop()))
+          exit_value -= Step->getValue()->getSExtValue();
+        lastsso << exit_value;
       } else{
-        upper.clear(); // upper bound is Unknown
+        last.clear(); // bound is Unknown
       }
+      lsso.flush();
+      usso.flush();
+    }
+
+    /// the iteration count of L as the SCEV {0,+,1}<L>; an i64 canonical
+    /// induction variable of L is the same SCEV
+    static const SCEVAddRecExpr *getIterCount(const Loop *L, ScalarEvolution *SE) {
+      Type *Ty = Type::getInt64Ty(L->getHeader()->getContext());
+      return cast<SCEVAddRecExpr>(SE->getAddRecExpr(SE->getZero(Ty), SE->getOne(Ty), L, SCEV::FlagAnyWrap));
     }
 
-    void printIVs(Loop *L, ScalarEvolution *SE, std::map<const SCEV *, PHINode *> &ivars, std::string prefix = "") {
-        PHINode *ivar = getInductionVariable(L, SE);
-        if (!ivar)
+    /// record the name of every induction variable of L (and of its subloops
+    /// if recurse is set) in ivars, along with the iteration count of each
+    /// loop, named k_<header>, unless a canonical IV already stands for it
+    void printIVs(Loop *L, ScalarEvolution *SE, std::map<const SCEV *, std::string> &ivars, std::string prefix = "", bool recurse = true) {
+        SmallVector<PHINode *, 4> IVs;
+        getInductionVariables(L, SE, IVs);
+        if (IVs.empty())
             errs() << prefix << "no induction variable for " << (std::string) L->getName() << "\n";
-        else
-            errs() << prefix << "found induction variable: " << (std::string) ivar->getName() << "\n";
-          const SCEV *E = SE->getSCEV(ivar);
-          if (E){
-            ivars[E] = ivar;
-            int64_t start_value = 0;
-            int64_t end_value = 0;
-            std::string start_value_str, end_value_str;
-            if (isa<SCEVNAryExpr>(E)){
-              const SCEVNAryExpr *AE = dyn_cast<SCEVNAryExpr>(E);
-              if (isa<SCEVConstant>(AE->getOperand(0))){
-                const SCEVConstant *CE = dyn_cast<SCEVConstant>(AE->getOperand(0));
-                start_value = CE->getValue()->getSExtValue();
-                start_value_str = std::to_string(start_value);
-              } else{
-                start_value_str = "u"; // u as an unknown variable. Maybe it should be infinity instead?
-              }
-              
-            }
-            // const SCEVConstant *EP = dyn_cast<SCEVConstant>(SE->getSCEVAtScope(E, L->getParentLoop()));
-            // end_value = EP->getValue()->getSExtValue();
-            const SCEV *EP = SE->getSCEVAtScope(E, L->getParentLoop());
-            if (isa<SCEVConstant>(EP)){
-              const SCEVConstant *EPP = dyn_cast<SCEVConstant>(EP);
-              end_value = EPP->getValue()->getSExtValue();
-              end_value_str = std::to_string(end_value);
-            } else{
-              end_value_str = "u"; // u as an unknown variable. Maybe it should be infinity instead? 
-            }
-            
-            EP->print(errs());
-            errs() << "\r\n";
-            errs() << "Start value: " << start_value << "\r\n";
-            errs() << "End value: " << end_value << "\r\n";
-          }
-        for (Loop *SL : L->getSubLoops())
+        for (PHINode *ivar : IVs) {
+          errs() << prefix << "found induction variable: " << (std::string) ivar->getName() << "\n";
+          const SCEVAddRecExpr *E = dyn_cast<SCEVAddRecExpr>(SE->getSCEV(ivar));
+          ivars[E] = ivar->getName();
+          std::string start_value_str, end_value_str;
+          IVgetRange(E, SE, start_value_str, end_value_str);
+          if (start_value_str.empty())
+            start_value_str = "u"; // u as an unknown variable. Maybe it should be infinity instead?
+          if (end_value_str.empty())
+            end_value_str = "u";
+          errs() << prefix << "  step: ";
+          E->getStepRecurrence(*SE)->print(errs());
+          errs() << "\r\n";
+          errs() << prefix << "  range: [" << start_value_str << ", " << end_value_str << "]\r\n";
+        }
+        const SCEVAddRecExpr *K = getIterCount(L, SE);
+        if (ivars.find(K) == ivars.end())
+          ivars[K] = "k_" + L->getHeader()->getName().str();
+        if (recurse)
+          for (Loop *SL : L->getSubLoops())
             printIVs(SL, SE, ivars, prefix + " ");
     }
 
@@ -246,34 +264,70 @@ namespace {
       return false;
     }
 
+    /// find an integer induction variable of RE's loop (among those already
+    /// collected in ivars_map) whose step evenly divides the step of RE; on
+    /// success, factor holds RE_Step / IV_Step. The loop's iteration count
+    /// always divides, so this only fails for a non-constant step. The IV
+    /// needing the smallest factor wins; ties go to a real IV over the
+    /// iteration count, then to the first name, so the choice is stable
+    const SCEVAddRecExpr *matchIndVar(const SCEVAddRecExpr *RE, ScalarEvolution *SE, const SCEV *&factor,
+      std::map<const SCEV *, std::string> &ivars_map) {
+      const SCEV *Step = RE->getStepRecurrence(*SE);
+      if (!isa<SCEVConstant>(Step))
+        return nullptr;
+      Type *Ty = RE->getType();
+      const SCEVAddRecExpr *K = getIterCount(RE->getLoop(), SE);
+      const SCEVAddRecExpr *best = nullptr;
+      for (auto pair : ivars_map) {
+        const SCEVAddRecExpr *IV = dyn_cast<SCEVAddRecExpr>(pair.first);
+        if (!IV || IV->getLoop() != RE->getLoop() || !IV->getType()->isIntegerTy())
+          continue;
+        const SCEV *IV_Step = SE->getTruncateOrSignExtend(IV->getStepRecurrence(*SE), Ty);
+        const SCEV *quotient = Step;
+        const SCEV *Step_rem = SE->getConstant(Ty, 0);
+        if (IV_Step->isZero())
+          continue;
+        if (!FactorOutConstant(quotient, Step_rem, IV_Step, *SE) || !Step_rem->isZero() || !isa<SCEVConstant>(quotient))
+          continue;
+        if (best) {
+          APInt q = cast<SCEVConstant>(quotient)->getAPInt().abs();
+          APInt bq = cast<SCEVConstant>(factor)->getAPInt().abs();
+          if (q.ugt(bq))
+            continue;
+          if (q == bq && (IV == K || (best != K && pair.second >= ivars_map[best])))
+            continue;
+        }
+        best = IV;
+        factor = quotient;
+      }
+      return best;
+    }
+
     bool compareToIndVars(const SCEV *offset, ScalarEvolution *SE, std::list<Coeff> &coeffs, const SCEVConstant *&cnst, 
-      std::map<const SCEV *, PHINode *> &ivars_map) {
+      std::map<const SCEV *, std::string> &ivars_map) {
       while (isa<SCEVAddRecExpr>(offset)) {
         const SCEVAddRecExpr *RE = dyn_cast<SCEVAddRecExpr>(offset);
         // (1) get corresponding induction variable for outermost SCEV
-        const SCEVAddRecExpr *IV = dyn_cast<SCEVAddRecExpr>(SE->getSCEV(getInductionVariable(RE->getLoop(), SE)));
         // (2) divide step of outermost SCEV by step of indvar SCEV
-        const SCEV *factor = RE->getStepRecurrence(*SE);  // initial value = RE_Step; after, (RE_Step = k * IV_Step) => (factor == k)
-        const SCEV *IV_Step = IV->getStepRecurrence(*SE);
-        const SCEV *Step_rem = nullptr;
+        const SCEV *factor = nullptr;  // (RE_Step = k * IV_Step) => (factor == k)
+        const SCEVAddRecExpr *IV = RE->isAffine() ? matchIndVar(RE, SE, factor, ivars_map) : nullptr;
 
-        assert(FactorOutConstant(factor, Step_rem, IV_Step, *SE) && "SE and its corresponding IV should have divisible steps");
-        errs() << " factored out ";
-        factor->print(errs());
-        errs() << "\r\n";
-
-        // not affine; abort
-        if (!isa<SCEVConstant>(factor)) {
+        // not affine, or no induction variable with a step dividing this one; abort
+        if (!IV) {
           coeffs.clear();
           return false;
         }
+        errs() << " factored out ";
+        factor->print(errs());
+        errs() << "\r\n";
         coeffs.push_back(Coeff { dyn_cast<SCEV>(IV), dyn_cast<SCEVConstant>(factor) });
 
         // (3) peel off a layer
         offset = RE->getStart();
 
         // (4) subtract factor*(start of IV) from the offset
-        offset = SE->getAddExpr(offset, SE->getNegativeSCEV(SE->getMulExpr(factor, IV->getStart())));
+        const SCEV *IV_Start = SE->getTruncateOrSignExtend(IV->getStart(), offset->getType());
+        offset = SE->getAddExpr(offset, SE->getNegativeSCEV(SE->getMulExpr(factor, IV_Start)));
       }
       cnst = dyn_cast<SCEVConstant>(offset);
       errs() << "    constant:";
@@ -288,7 +342,7 @@ namespace {
       return true;
     }
 
-    void printIndexFunction(std::list<Coeff> &coeffs, const SCEVConstant *scnst, std::map<const SCEV *, PHINode *> &ivars_map) {
+    void printIndexFunction(std::list<Coeff> &coeffs, const SCEVConstant *scnst, std::map<const SCEV *, std::string> &ivars_map) {
       bool first = true;
       for (auto pair : coeffs) {
         if (!first)
@@ -296,7 +350,7 @@ namespace {
         else
           first = false;
         pair.coeff->print(errs());
-        errs() << "*" << ivars_map[pair.indvar]->getName();
+        errs() << "*" << ivars_map[pair.indvar];
       }
       if (scnst) {
         if (!first)
@@ -314,7 +368,10 @@ namespace {
       std::list<Coeff> coeffs;
       const SCEVConstant *cnst;
 
-      std::string to_string(std::map<const SCEV *, PHINode *> &iv_map, std::string post, std::map<std::string, const SCEV *> &ivars_instanced) const {
+      /// induction variables of loops outside of nest are fixed for the whole
+      /// nest, so they are shared between instances and get no suffix
+      std::string to_string(std::map<const SCEV *, std::string> &iv_map, std::string post, std::map<std::string, const SCEV *> &ivars_instanced,
+                            const Loop *nest = nullptr) const {
         std::string s;
         raw_string_ostream stream(s);
 
@@ -323,6 +380,8 @@ namespace {
 
         bool first = true;
         for (auto coeff : coeffs) {
+          const SCEVAddRecExpr *IV = dyn_cast<SCEVAddRecExpr>(coeff.indvar);
+          bool shared = nest && IV && !nest->contains(IV->getLoop());
           assert(iv_map.find(coeff.indvar) != iv_map.end() && "indvar SCEV doesn't map to an indvar");
           assert(coeff.coeff && "coeff cannot be null");
           std::string iname;   // instance name
@@ -333,7 +392,7 @@ namespace {
           else
             first = false;
           coeff.coeff->print(stream);
-          iname_stream << iv_map[coeff.indvar]->getName() << post;
+          iname_stream << iv_map[coeff.indvar] << (shared ? "" : post);
           iname_stream.flush();
           stream << "*" << glpsolName(iname);
           ivars_instanced[iname] = coeff.indvar;
@@ -348,15 +407,32 @@ namespace {
         return s;
       }
 
-      std::string to_string(std::map<const SCEV *, PHINode *> &iv_map) const {
+      std::string to_string(std::map<const SCEV *, std::string> &iv_map) const {
         std::map<std::string, const SCEV *> dummy;
         return to_string(iv_map, "", dummy);
       }
     };
 
+    /// element offset of an access from its array's base: (pointer - base) /
+    /// element size, e.g. *p with p = {a,+,4} over i32 is a[{0,+,1}], and
+    /// a[i][j] on int a[100][100] is a[100*i + j]. Returns nullptr if the offset
+    /// is not a whole number of elements
+    const SCEV *getElementOffset(Instruction *I, const SCEV *ptr, const SCEV *base, ScalarEvolution *SE) {
+      const DataLayout &DL = I->getModule()->getDataLayout();
+      Type *AccessTy = isa<LoadInst>(I) ? I->getType() : cast<StoreInst>(I)->getValueOperand()->getType();
+      const SCEV *idx = SE->getMinusSCEV(ptr, base);
+      Type *Ty = SE->getEffectiveSCEVType(idx->getType());
+      const SCEV *eltsize = SE->getConstant(Ty, DL.getTypeAllocSize(AccessTy));
+      const SCEV *rem = SE->getConstant(Ty, 0);
+      if (!FactorOutConstant(idx, rem, eltsize, *SE) || !rem->isZero())
+        return nullptr;
+      return idx;
+    }
+
     struct ArrayAccess {
       Instruction *I;
       std::list<Equation> idxs;
+      std::list<Equation> flat;   // the element offset as a single index, if affine
     };
 
     bool runOnFunction(Function &F) override {
@@ -365,15 +441,18 @@ namespace {
 
       ilp_file << "/* " << (std::string) F.getName() << "() */\n";
 
-      // (1) for each loop L
-      // (2) populate SCEV -> IV map
+      // (1) for each loop L, at any depth, treated as the root of its own subnest
+      // (2) populate SCEV -> IV map, including the IVs of enclosing loops
       // (3) for each instruction in the loop
       // (4) if load/store, get base addr and save to ls_map
 
-      for (Loop *L : LI) {
-        std::map<const SCEV *, PHINode *> iv_map;
+      for (Loop *L : LI.getLoopsInPreorder()) {
+        std::map<const SCEV *, std::string> iv_map;
         std::map<const SCEV *, std::list<ArrayAccess>> base_map;
 
+        errs() << "analyzing loop " << (std::string) L->getName() << " at depth " << L->getLoopDepth() << "\r\n";
+        for (Loop *PL = L->getParentLoop(); PL; PL = PL->getParentLoop())
+          printIVs(PL, &SE, iv_map, "", false); // enclosing IVs are fixed within this subnest
         printIVs(L, &SE, iv_map); // populate iv_map
         for (Loop::block_iterator li = L->block_begin(); li != L->block_end(); ++li) {
           BasicBlock *BB = *li;
@@ -382,31 +461,62 @@ namespace {
 
             if (isa<LoadInst>(I) || isa<StoreInst>(I)) {
               const SCEV *base = nullptr;
-              SmallVector<GetElementPtrInst *, 4> geps_list;
-              std::set<Instruction *> seen;
-
-              getGEPs(I, geps_list, seen); // get all getelementptr instructions that this instruction depends on
-              for (GetElementPtrInst *gep : geps_list){
-                if (!isa<GetElementPtrInst>(gep->getOperand(0))){
-                  base = SE.getSCEV(gep->getOperand(0));  // TODO: maybe use llvm::Value instead of SCEV here?
-                  break;
+              SmallVector<const SCEV *, 4> idx_list;
+              Value *ptr = getLoadStorePointerOperand(I);
+
+              Value *root = ptr;
+              if (GetElementPtrInst *gep = dyn_cast<GetElementPtrInst>(ptr))
+                root = gep->getPointerOperand();
+
+              if (isa<PHINode>(root) && iv_map.find(SE.getSCEV(root)) != iv_map.end()) {
+                // an access through a pointer induction variable (*p or p[c]) has a
+                // single index, its element offset from the pointer's base
+                base = SE.getPointerBase(SE.getSCEV(ptr));
+                idx_list.push_back(getElementOffset(I, SE.getSCEV(ptr), base, &SE));
+              } else {
+                SmallVector<GetElementPtrInst *, 4> geps_list;
+                std::set<Instruction *> seen;
+
+                // get all getelementptr instructions that the address of this instruction depends on
+                // (not the value being stored, which may itself be loaded from another array)
+                if (Instruction *PI = dyn_cast<Instruction>(ptr))
+                  getGEPs(PI, geps_list, seen);
+                for (GetElementPtrInst *gep : geps_list){
+                  if (!isa<GetElementPtrInst>(gep->getOperand(0))){
+                    base = SE.getSCEV(gep->getOperand(0));  // TODO: maybe use llvm::Value instead of SCEV here?
+                    break;
+                  }
                 }
+                // get an equation for each getelementptr instruction (index); a
+                // GEP without a third operand (e.g. p + 1) has none
+                for (GetElementPtrInst *gep : geps_list)
+                  idx_list.push_back(getGEPThirdArg(gep, &SE));
               }
-              if (base_map.find(base) == base_map.end())
-                base_map[base] = std::list<ArrayAccess>();
-              
+
               ArrayAccess aa = { .I = I };
-              bool isAffine = true;
-              for (GetElementPtrInst *gep : geps_list) {
-                // get an equation for each getelementptr instruction (index)
-                const SCEV *scev = getGEPThirdArg(gep, &SE);
+              bool isAffine = base != nullptr;
+              for (const SCEV *scev : idx_list) {
                 std::list<Coeff> expr_coeffs;
                 const SCEVConstant *expr_const = nullptr;
-                if (!(isAffine = compareToIndVars(scev, &SE, expr_coeffs, expr_const, iv_map)))
+                if (!scev || !compareToIndVars(scev, &SE, expr_coeffs, expr_const, iv_map)) {
+                  isAffine = false;
                   break;
+                }
                 aa.idxs.push_back(Equation { expr_coeffs, expr_const });
               }
 
+              // flatten the access too, so it can be compared with references to
+              // the same base that have a different number of index functions
+              if (isAffine && aa.idxs.size() == 1)
+                aa.flat = aa.idxs;
+              else if (isAffine) {
+                const SCEV *offset = getElementOffset(I, SE.getSCEV(ptr), base, &SE);
+                std::list<Coeff> expr_coeffs;
+                const SCEVConstant *expr_const = nullptr;
+                if (offset && compareToIndVars(offset, &SE, expr_coeffs, expr_const, iv_map))
+                  aa.flat.push_back(Equation { expr_coeffs, expr_const });
+              }
+
               if (isAffine)
                 base_map[base].push_back(aa);
               else
@@ -423,6 +533,8 @@ namespace {
         // for example, if the induction variable is "indvar.iv",
         // then a possible instance of it would be "indvar.iv_a"
         std::map<std::string, const SCEV *> ivars_instanced;
+        // bases with a pair of references that cannot be compared
+        std::set<const SCEV *> unanalyzable;
         std::string eqns;
         raw_string_ostream eqns_s(eqns);
         size_t neqns = 0;
@@ -452,26 +564,87 @@ namespace {
             for (auto it2 = std::next(it); it2 != pair.second.end(); it2++) {
               if (!(isa<StoreInst>(it->I) || isa<StoreInst>(it2->I)))
                 continue;
-              auto fidx_it = it->idxs.begin();    // f_i()
-              auto gidx_it = it2->idxs.begin();   // g_i()
+              // references with different numbers of index functions (e.g. *p
+              // through a pointer IV against a[i][j]) are compared by their
+              // element offsets instead
+              const std::list<Equation> *fidxs = &it->idxs, *gidxs = &it2->idxs;
+              if (fidxs->size() != gidxs->size()) {
+                fidxs = &it->flat;
+                gidxs = &it2->flat;
+              }
+              if (fidxs->empty() || gidxs->empty()) {
+                errs() << "cannot compare a pair of references to " << pair.first << "\r\n";
+                unanalyzable.insert(pair.first);
+                continue;
+              }
+              auto fidx_it = fidxs->begin();    // f_i()
+              auto gidx_it = gidxs->begin();    // g_i()
 
-              for (; fidx_it != it->idxs.end() && gidx_it != it2->idxs.end(); fidx_it++,gidx_it++) {
-                eqns_s << "s.t. eqn" << neqns << ": " << fidx_it->to_string(iv_map, "a", ivars_instanced) 
-                << " = " << gidx_it->to_string(iv_map, "B", ivars_instanced) << ";\n";
+              for (; fidx_it != fidxs->end() && gidx_it != gidxs->end(); fidx_it++,gidx_it++) {
+                eqns_s << "s.t. eqn" << neqns << ": " << fidx_it->to_string(iv_map, "a", ivars_instanced, L) 
+                << " = " << gidx_it->to_string(iv_map, "B", ivars_instanced, L) << ";\n";
                 neqns++;
               }
-
-              assert(fidx_it == it->idxs.end() && "references to same memory location have different number of index functions");
-              assert(gidx_it == it2->idxs.end() && "references to same memory location have different number of index functions");
             }
           }
           eqns_s.flush();
         }
 
+        // tie every induction variable other than the iteration count itself to
+        // the iteration count of its loop instance: iv = start + step*k. The ILP
+        // then only admits values the loop reaches, and all IVs of the same loop
+        // instance move in lockstep. Writing a constraint may instance more
+        // variables (outer IVs, k), so repeat until every instanced variable
+        // has been visited
+        std::set<std::string> visited;
+        for (bool changed = true; changed;) {
+          changed = false;
+          for (auto pair : ivars_instanced) {
+            if (!visited.insert(pair.first).second)
+              continue;
+            changed = true;
+            assert(isa<SCEVAddRecExpr>(pair.second) && "induction variable is not a SCEVAddRecExpr");
+            const SCEVAddRecExpr *IV = dyn_cast<SCEVAddRecExpr>(pair.second);
+            const SCEVConstant *step = dyn_cast<SCEVConstant>(IV->getStepRecurrence(SE));
+            if (!step || IV == getIterCount(IV->getLoop(), &SE))
+              continue;
+            Equation start = { std::list<Coeff>(), nullptr };
+            if (!compareToIndVars(IV->getStart(), &SE, start.coeffs, start.cnst, iv_map) || !start.cnst)
+              continue;   // start is not affine in the IVs; only the range applies
+            start.coeffs.push_back(Coeff { getIterCount(IV->getLoop(), &SE), step });
+            std::string post = pair.first.substr(iv_map[IV].size());  // "", "_a" or "_B"
+            if (!post.empty())
+              post = post.substr(1);
+            eqns_s << "s.t. stride_" << glpsolName(pair.first) << ": " << glpsolName(pair.first) << " = "
+              << start.to_string(iv_map, post, ivars_instanced, L) << ";\n";
+          }
+        }
+        eqns_s.flush();
+
+        if (ivars_instanced.empty() && unanalyzable.empty())
+          continue;
+
+        // each loop gets its own model; glpsol stops at the first "end;", so
+        // the models have to be split apart at these comments to be solved
+        ilp_file << "/* loop " << (std::string) L->getName() << ", depth " << L->getLoopDepth() << " */" << std::endl;
+
+        // a pair of references that cannot be compared may still overlap, so
+        // write no model that could report this loop as dependence-free
+        if (!unanalyzable.empty()) {
+          for (const SCEV *base : unanalyzable) {
+            std::string name;
+            raw_string_ostream name_stream(name);
+            base->print(name_stream);
+            name_stream.flush();
+            ilp_file << "/* references to " << name << " cannot be compared; assume a dependence */" << std::endl;
+          }
+          ilp_file << std::endl;
+          continue;
+        }
+
         // print ranges for induction variables
         for (auto pair : ivars_instanced) {
           std::string lower, upper;
-          assert(isa<SCEVAddRecExpr>(pair.second) && "induction variable is not a SCEVAddRecExpr");
           IVgetRange(dyn_cast<SCEVAddRecExpr>(pair.second), &SE, lower, upper);
           ilp_file << "var " << glpsolName(pair.first);
           if (!lower.empty())
@@ -481,12 +654,9 @@ namespace {
           ilp_file << " integer;" << std::endl;
         }
 
-        // just pick some variable to maximize; we only care whether a solution exists
-        if (ivars_instanced.empty())
-          continue;
-        else
-          ilp_file << std::endl;
+        ilp_file << std::endl;
 
+        // just pick some variable to maximize; we only care whether a solution exists
         auto fpair = &*ivars_instanced.begin();
         ilp_file << "maximize keks: " << glpsolName(fpair->first) << ";" << std::endl << std::endl;
         ilp_file << eqns << std::endl;
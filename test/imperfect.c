@@ -0,0 +1,18 @@
+void foo() {
+    int a[100][100];
+    int b[100];
+
+    for (int i = 0; i < 99; i++) {
+        b[i] = b[i + 1];
+        for (int j = 0; j < 99; j++) {
+            a[i][j] = a[i][j + 1];
+        }
+        for (int k = 0; k < 99; k++) {
+            a[i + 1][k] = a[i][k];
+        }
+    }
+}
+
+int main() {
+    foo();
+}
@@ -0,0 +1,35 @@
+void foo() {
+    int a[1000];
+    int *p = a;
+
+    for (int i = 0; i < 999; i++) {
+        *p = a[i + 1];
+        p++;
+    }
+}
+
+void bar(int *q) {
+    int *p = q;
+
+    for (int n = 0; n < 50; n++) {
+        p[0] = p[2];
+        p += 3;
+    }
+}
+
+void baz() {
+    int a[100][100];
+    int *p = &a[0][0];
+
+    for (int i = 0; i < 99; i++) {
+        *p = a[1][i];
+        p++;
+    }
+}
+
+int main() {
+    int b[200];
+    foo();
+    bar(b);
+    baz();
+}
@@ -0,0 +1,49 @@
+void foo() {
+    int a[1000];
+
+    for (int i = 998; i >= 0; i -= 2) {
+        a[i] = a[i + 2];
+    }
+}
+
+void bar() {
+    int a[1000];
+
+    for (int i = 0; i < 990; i += 3) {
+        a[i] = a[i + 1];
+    }
+}
+
+void baz() {
+    int a[1000];
+
+    for (int i = 0, j = 500; i < 400; i += 2, j += 2) {
+        a[i] = a[j];
+    }
+}
+
+void quux() {
+    int b[100][100];
+
+    for (int i = 5, j = 0; i < 50; i++, j += 2) {
+        b[i][j] = b[i - 1][j + 2];
+    }
+}
+
+void qux() {
+    int a[1000];
+
+    for (int i = 0; i < 100; i++) {
+        for (int j = i; j < 100; j += 2) {
+            a[j] = a[i + 1];
+        }
+    }
+}
+
+int main() {
+    foo();
+    bar();
+    baz();
+    qux();
+    quux();
+}